@@ -1,6 +1,13 @@
 #include "s3fifo_rocksdb.hpp"
 #include <iostream>
+#include <map>
 #include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <random>
+#include <chrono>
+#include <thread>
 
 void runPaperExample() {
     std::cout << "\n=== Running Paper Example Test ===\n";
@@ -113,12 +120,781 @@ void runScanResistanceTest() {
     std::cout << "\nHot items survived scan: " << (hot_items_survived ? "Yes" : "No") << "\n";
 }
 
+// Open a cache on path with logging quieted to warnings; construction
+// resets the shared logger to debug
+std::unique_ptr<S3FIFORocksDB> openQuiet(const std::string& path, size_t size,
+                                         const S3FIFOOptions& options = S3FIFOOptions()) {
+    auto cache = std::make_unique<S3FIFORocksDB>(path, size, 0.1, 0.1, options);
+    spdlog::get("s3fifo")->set_level(spdlog::level::warn);
+    return cache;
+}
+
+// openQuiet() on an emptied path
+std::unique_ptr<S3FIFORocksDB> openFresh(const std::string& path, size_t size,
+                                         const S3FIFOOptions& options = S3FIFOOptions()) {
+    std::filesystem::remove_all(path);
+    return openQuiet(path, size, options);
+}
+
+// JSON-ish value of roughly 1KB with repetitive structure
+std::string makeJsonValue(uint64_t id, std::mt19937_64& rng) {
+    std::string value = "{\"id\":" + std::to_string(id) + ",\"events\":[";
+    while (value.size() < 1024) {
+        value += "{\"type\":\"page_view\",\"status\":\"active\",\"region\":\"us-east-1\","
+                 "\"latency_ms\":" + std::to_string(rng() % 500) +
+                 ",\"user\":\"user_" + std::to_string(rng() % 10000) + "\"},";
+    }
+    value += "]}";
+    return value;
+}
+
+void runCompressionBenchmark() {
+    std::cout << "\n=== Running Compression Benchmark ===\n";
+
+    struct Policy {
+        const char* name;
+        rocksdb::CompressionType type;
+        uint32_t dict_bytes;
+    };
+    const Policy policies[] = {
+        {"none", rocksdb::kNoCompression, 0},
+        {"lz4", rocksdb::kLZ4Compression, 0},
+        {"zstd+dict", rocksdb::kZSTD, 16 * 1024},
+    };
+
+    const size_t CACHE_SIZE = 64 * 1024 * 1024;   // 64MB
+    const uint64_t KEY_SPACE = 200000;            // ~200MB of values
+    const int REQUESTS = 400000;
+
+    for (const auto& policy : policies) {
+        S3FIFOOptions options;
+        options.main_compression = policy.type;
+        options.main_dict_bytes = policy.dict_bytes;
+        auto cache = openFresh(std::string("/tmp/s3fifo_compression_") + policy.name, CACHE_SIZE, options);
+
+        // Skewed (Zipf-like) access; a miss fetches and inserts the object
+        std::mt19937_64 rng(42);
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        std::clock_t cpu_start = std::clock();
+        for (int i = 0; i < REQUESTS; i++) {
+            uint64_t id = static_cast<uint64_t>(KEY_SPACE * std::pow(uniform(rng), 3.0));
+            std::string key = "obj" + std::to_string(id);
+            std::string value;
+            if (!cache->get(key, &value).ok()) {
+                cache->put(key, makeJsonValue(id, rng));
+            }
+        }
+        double cpu_seconds = static_cast<double>(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+
+        auto stats = cache->getStats();
+        std::cout << policy.name
+                  << ": hit ratio " << stats.hit_ratio()
+                  << ", CPU " << cpu_seconds << "s"
+                  << " (" << cpu_seconds * 1e6 / REQUESTS << " us/request)"
+                  << ", main compression ratio " << stats.main_compression_ratio
+                  << ", main items " << stats.main_items << "\n";
+    }
+}
+
+// Put throughput with group commit at increasing writer counts
+void runGroupCommitBenchmark() {
+    std::cout << "\n=== Running Group Commit Benchmark ===\n";
+
+    const size_t CACHE_SIZE = 256 * 1024 * 1024;   // 256MB
+    const int PUTS_PER_THREAD = 20000;
+    const std::string VALUE(1024, 'v');
+
+    for (size_t threads : {1, 8, 32}) {
+        S3FIFOOptions options;
+        options.enable_pipelined_write = true;
+        auto cache = openFresh("/tmp/s3fifo_group_commit", CACHE_SIZE, options);
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> writers;
+        for (size_t t = 0; t < threads; t++) {
+            writers.emplace_back([&, t] {
+                for (int i = 0; i < PUTS_PER_THREAD; i++) {
+                    cache->put("w" + std::to_string(t) + "_" + std::to_string(i), VALUE);
+                }
+            });
+        }
+        for (auto& writer : writers) {
+            writer.join();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        auto stats = cache->getStats();
+        std::cout << threads << " threads: "
+                  << threads * PUTS_PER_THREAD / seconds / 1000 << " Kputs/s"
+                  << ", average group " << static_cast<double>(stats.grouped_puts) / stats.write_groups
+                  << " puts\n";
+    }
+}
+
+// The checks below print what they find and return false if one fails.
+// Unless a check needs otherwise, its cache has this size.
+const size_t TEST_CACHE_SIZE = 4 * 1024 * 1024;   // 4MB
+
+// multiPut: repeated keys, per-object failures and a bulk load larger
+// than the cache
+bool runMultiPutTest() {
+    std::cout << "\n=== Running MultiPut Test ===\n";
+
+    S3FIFOOptions options;
+    options.max_value_size = 64 * 1024;
+    auto cache = openFresh("/tmp/s3fifo_multiput_test", TEST_CACHE_SIZE, options);
+
+    // A repeated key keeps its last value
+    std::string value;
+    cache->multiPut({{"R", "first"}, {"S", "valueS"}, {"R", "last"}});
+    bool last_wins = cache->get("R", &value).ok() && value == "last";
+    std::cout << "Repeated key keeps last value: " << (last_wins ? "Yes" : "No") << "\n";
+
+    // An oversized value fails alone; the rest of the batch lands
+    std::vector<rocksdb::Status> statuses;
+    auto status = cache->multiPut({{"T", "valueT"},
+                                  {"U", std::string(options.max_value_size + 1, 'u')}},
+                                 &statuses);
+    bool failure_reported = status.IsInvalidArgument() && statuses.size() == 2 &&
+                            statuses[0].ok() && statuses[1].IsInvalidArgument() &&
+                            cache->get("T", &value).ok() && !cache->get("U", &value).ok();
+    std::cout << "Oversized value rejected alone: " << (failure_reported ? "Yes" : "No") << "\n";
+
+    // A bulk load of 4x the cache, far more than one eviction batch, must
+    // leave both tiers within their budgets and the newest objects readable
+    const int OBJECTS = 16 * 1024;
+    std::vector<std::pair<std::string, std::string>> bulk;
+    for (int i = 0; i < OBJECTS; i++) {
+        bulk.emplace_back("bulk" + std::to_string(i), std::string(1024, 'a' + i % 26));
+    }
+    status = cache->multiPut(bulk);
+    auto stats = cache->getStats();
+    bool within_budget = status.ok() &&
+                         stats.small_bytes <= TEST_CACHE_SIZE * 0.1 &&
+                         stats.main_bytes <= TEST_CACHE_SIZE * 0.9 &&
+                         cache->get(bulk.back().first, &value).ok() && value == bulk.back().second;
+    std::cout << "Bulk load of " << OBJECTS << " objects: small " << stats.small_bytes
+              << " bytes, main " << stats.main_bytes << " bytes, within budget: "
+              << (within_budget ? "Yes" : "No") << "\n";
+
+    return last_wins && failure_reported && within_budget;
+}
+
+// ingestWarmup: files are indexed at the main tail, and a set larger
+// than the main budget is refused
+bool runWarmupTest() {
+    std::cout << "\n=== Running Warm-up Ingest Test ===\n";
+
+    std::string path = "/tmp/s3fifo_warmup_test";
+    std::filesystem::create_directories(path + "_files");
+    auto cache = openFresh(path, TEST_CACHE_SIZE);
+    for (int i = 0; i < 1000; i++) {
+        cache->put("live" + std::to_string(i), std::string(1024, 'l'));
+    }
+
+    // Objects of 1KB from the cache's next sequence on, one file per call
+    auto build = [&](const std::string& file, int objects) {
+        S3FIFORocksDB::WarmupWriter writer(cache->nextSequence());
+        auto status = writer.open(file);
+        for (int i = 0; status.ok() && i < objects; i++) {
+            status = writer.add("warm" + std::to_string(i), std::string(1024, 'w'));
+        }
+        return status.ok() ? writer.finish() : status;
+    };
+
+    std::string value;
+    std::string fits = path + "_files/fits.sst";
+    auto status = build(fits, 2000);
+    if (status.ok()) {
+        status = cache->ingestWarmup({fits});
+    }
+    auto stats = cache->getStats();
+    bool ingested = status.ok() &&
+                    cache->get("warm1999", &value).ok() && value == std::string(1024, 'w') &&
+                    stats.main_bytes <= TEST_CACHE_SIZE * 0.9;
+    std::cout << "Ingested 2000 objects within budget: " << (ingested ? "Yes" : "No") << "\n";
+
+    std::string too_big = path + "_files/too_big.sst";
+    status = build(too_big, 8000);
+    if (status.ok()) {
+        status = cache->ingestWarmup({too_big});
+    }
+    bool refused = status.IsInvalidArgument() && cache->get("warm1999", &value).ok();
+    std::cout << "Refused a set larger than the main budget: " << (refused ? "Yes" : "No") << "\n";
+
+    return ingested && refused;
+}
+
+// Hot-set transfer: a round trip keeps tiers and frequencies, and a
+// damaged file is refused
+bool runHotSetTest() {
+    std::cout << "\n=== Running Hot-set Transfer Test ===\n";
+
+    std::string file = "/tmp/s3fifo_hot_set.bin";
+    uint64_t exported = 0;
+    {
+        auto source = openFresh("/tmp/s3fifo_hot_set_source", TEST_CACHE_SIZE);
+        std::string value;
+        for (int i = 0; i < 100; i++) {
+            std::string key = "hot" + std::to_string(i);
+            source->put(key, "value" + key);
+            source->get(key, &value);   // Accessed since insertion, so exported
+        }
+        source->exportHotSet(file, 0, &exported);
+    }
+
+    auto target = openFresh("/tmp/s3fifo_hot_set_target", TEST_CACHE_SIZE);
+    uint64_t imported = 0;
+    std::string value;
+    bool round_trip = exported == 100 && !std::filesystem::exists(file + ".tmp") &&
+                      target->importHotSet(file, &imported).ok() && imported == exported &&
+                      target->get("hot42", &value).ok() && value == "valuehot42";
+    std::cout << "Round trip of " << exported << " objects: " << (round_trip ? "Yes" : "No") << "\n";
+
+    // Claim a 4GB value in the first record; it must fail before allocating
+    std::string damaged = file + ".damaged";
+    std::filesystem::copy_file(file, damaged, std::filesystem::copy_options::overwrite_existing);
+    {
+        std::fstream out(damaged, std::ios::binary | std::ios::in | std::ios::out);
+        out.seekp(8 + 6);   // Magic, tier, frequency, key length
+        out.write("\xff\xff\xff\xff", 4);
+    }
+    bool damage_refused = target->importHotSet(damaged).IsCorruption();
+    std::filesystem::copy_file(file, damaged, std::filesystem::copy_options::overwrite_existing);
+    std::filesystem::resize_file(damaged, std::filesystem::file_size(file) - 3);
+    damage_refused = damage_refused && target->importHotSet(damaged).IsCorruption();
+    std::cout << "Damaged and truncated files refused: " << (damage_refused ? "Yes" : "No") << "\n";
+
+    return round_trip && damage_refused;
+}
+
+// resize: shrinking a full cache leaves both tiers within the new budgets
+bool runResizeTest() {
+    std::cout << "\n=== Running Resize Test ===\n";
+
+    const size_t NEW_SIZE = 2 * 1024 * 1024;   // From 8MB
+
+    S3FIFOOptions options;
+    options.resize_step_bytes = 1024 * 1024;
+    options.resize_bytes_per_sec = 0;
+    options.config.promotion_probability = 1.0;
+    options.config.min_access_count = 1;
+    auto cache = openFresh("/tmp/s3fifo_resize_test", 8 * 1024 * 1024, options);
+
+    // Fill both tiers: every other object is promoted to the small queue
+    // and hit there, so shrinking moves it back to main
+    std::string value;
+    for (int i = 0; i < 8000; i++) {
+        std::string key = "obj" + std::to_string(i);
+        cache->put(key, std::string(1024, 'r'));
+        if (i % 2 == 0) {
+            cache->get(key, &value);
+            cache->get(key, &value);
+        }
+    }
+    auto before = cache->getStats();
+
+    auto status = cache->resize(NEW_SIZE);
+    auto stats = cache->getStats();
+    bool shrunk = status.ok() && before.small_bytes > NEW_SIZE * 0.1 &&
+                  cache->totalSize() == NEW_SIZE &&
+                  stats.small_bytes <= NEW_SIZE * 0.1 &&
+                  stats.main_bytes <= NEW_SIZE * 0.9;
+    std::cout << "Shrunk to " << NEW_SIZE << " bytes: small " << stats.small_bytes
+              << " bytes, main " << stats.main_bytes << " bytes, within budget: "
+              << (shrunk ? "Yes" : "No") << "\n";
+
+    return shrunk;
+}
+
+// Recovery: plain and headed, whole and chunked entries, some of them
+// overwritten, come back from a parallel recovery with the same contents
+// and the same accounting
+bool runRecoveryTest() {
+    std::cout << "\n=== Running Recovery Test ===\n";
+
+    const size_t CACHE_SIZE = 8 * 1024 * 1024;   // 8MB, larger than the data
+    std::string path = "/tmp/s3fifo_recovery_test";
+
+    S3FIFOOptions options;
+    options.chunking_threshold = 8 * 1024;
+    options.chunk_size = 2 * 1024;
+    options.recovery_threads = 4;
+    options.config.promotion_probability = 1.0;
+    options.config.min_access_count = 1;
+
+    // Expected contents: key -> value
+    std::map<std::string, std::string> expected;
+    auto write = [&](S3FIFORocksDB& cache, const std::string& prefix) {
+        std::string value;
+        for (int i = 0; i < 300; i++) {
+            std::string key = prefix + std::to_string(i);
+            size_t size = i % 10 == 0 ? 10 * 1024 : 100 + i;   // Every tenth chunked
+            expected[key] = std::string(size, 'a' + i % 26);
+            cache.put(key, expected[key]);
+            if (i % 3 == 0) {
+                cache.get(key, &value);   // Promoted to the small queue
+            }
+        }
+        for (int i = 0; i < 300; i += 7) {
+            std::string key = prefix + std::to_string(i);
+            expected[key] = "overwritten" + key;
+            cache.put(key, expected[key]);
+        }
+    };
+    auto contentsMatch = [&](S3FIFORocksDB& cache) {
+        std::string value;
+        for (const auto& [key, want] : expected) {
+            if (!cache.get(key, &value).ok() || value != want) {
+                return false;
+            }
+        }
+        return true;
+    };
+    auto sameAccounting = [](const S3FIFORocksDB::Statistics& a, const S3FIFORocksDB::Statistics& b) {
+        return a.small_items == b.small_items && a.main_items == b.main_items &&
+               a.small_bytes == b.small_bytes && a.main_bytes == b.main_bytes &&
+               a.small_stale_items == b.small_stale_items && a.main_stale_items == b.main_stale_items;
+    };
+
+    S3FIFORocksDB::Statistics before;
+    {
+        auto cache = openFresh(path, CACHE_SIZE, options);
+        write(*cache, "plain");
+    }
+    options.value_header = true;
+    {
+        auto cache = openQuiet(path, CACHE_SIZE, options);
+        write(*cache, "headed");
+        before = cache->getStats();
+    }
+
+    auto cache = openQuiet(path, CACHE_SIZE, options);
+    auto after = cache->getStats();
+    bool accounted = sameAccounting(before, after) && after.small_items > 0 && after.main_stale_items > 0;
+    std::cout << "Recovered " << after.small_items << " small and " << after.main_items
+              << " main objects, " << after.small_stale_items + after.main_stale_items
+              << " stale entries, accounting unchanged: " << (accounted ? "Yes" : "No") << "\n";
+    bool intact = contentsMatch(*cache);
+    std::cout << "Recovered contents match: " << (intact ? "Yes" : "No") << "\n";
+
+    return accounted && intact;
+}
+
+// Online checkpoint: the clone opens with the same objects and consumes
+// its metadata snapshot, and a damaged snapshot is ignored
+bool runCheckpointTest() {
+    std::cout << "\n=== Running Checkpoint Test ===\n";
+
+    std::string path = "/tmp/s3fifo_checkpoint_test";
+    std::string clone_path = path + "_clone";
+    std::string damaged_path = path + "_damaged";
+    std::filesystem::remove_all(clone_path);
+    std::filesystem::remove_all(damaged_path);
+    auto cache = openFresh(path, TEST_CACHE_SIZE);
+    std::string value;
+    for (int i = 0; i < 200; i++) {
+        std::string key = "ckpt" + std::to_string(i);
+        cache->put(key, "value" + key);
+        if (i % 2 == 0) {
+            cache->get(key, &value);
+        }
+    }
+
+    bool taken = cache->checkpoint(clone_path).ok() &&
+                 std::filesystem::exists(clone_path + "/s3fifo.meta") &&
+                 !std::filesystem::exists(clone_path + ".tmp") &&
+                 cache->checkpoint(clone_path).IsInvalidArgument();
+    std::cout << "Checkpoint taken, existing directory refused: " << (taken ? "Yes" : "No") << "\n";
+
+    auto stats = cache->getStats();
+    auto clone = openQuiet(clone_path, TEST_CACHE_SIZE);
+    auto clone_stats = clone->getStats();
+    bool cloned = clone_stats.small_items == stats.small_items &&
+                  clone_stats.main_items == stats.main_items &&
+                  clone->get("ckpt123", &value).ok() && value == "valueckpt123" &&
+                  !std::filesystem::exists(clone_path + "/s3fifo.meta");
+    std::cout << "Clone opened with the same " << clone_stats.main_items << " objects: "
+              << (cloned ? "Yes" : "No") << "\n";
+
+    // Claim a 4GB key in the first snapshot record; the clone must still open
+    bool damage_ignored = cache->checkpoint(damaged_path).ok();
+    {
+        std::fstream out(damaged_path + "/s3fifo.meta", std::ios::binary | std::ios::in | std::ios::out);
+        out.seekp(8 + 1);   // Magic, frequency
+        out.write("\xff\xff\xff\xff", 4);
+    }
+    {
+        auto damaged = openQuiet(damaged_path, TEST_CACHE_SIZE);
+        damage_ignored = damage_ignored && damaged->getStats().main_items == stats.main_items &&
+                         damaged->get("ckpt123", &value).ok();
+    }
+    std::cout << "Damaged metadata snapshot ignored: " << (damage_ignored ? "Yes" : "No") << "\n";
+
+    return taken && cloned && damage_ignored;
+}
+
+// Read-only secondary: after catchUp() it indexes what the primary
+// appended, drops what the primary evicted and forwards its hits, with
+// or without the shared-memory index mirror
+bool runSecondaryTest(size_t shared_index_slots) {
+    std::cout << "\n=== Running Secondary Test ("
+              << (shared_index_slots > 0 ? "shared index" : "own index") << ") ===\n";
+
+    const size_t CACHE_SIZE = 1024 * 1024;   // 1MB
+    std::string path = "/tmp/s3fifo_secondary_test";
+    std::filesystem::remove_all(path + "_secondary");
+    SharedIndex::remove(SharedIndex::nameFor(path));   // Left by an earlier run
+
+    S3FIFOOptions options;
+    options.hint_ring_slots = 1024;
+    options.shared_index_slots = shared_index_slots;
+    auto primary = openFresh(path, CACHE_SIZE, options);
+    auto write = [&](int from, int to) {
+        for (int i = from; i < to; i++) {
+            primary->put("sec" + std::to_string(i), std::string(1024, 's'));
+        }
+    };
+    write(0, 500);
+
+    S3FIFOOptions secondary_options = options;
+    secondary_options.secondary_path = path + "_secondary";
+    auto secondary = openQuiet(path, CACHE_SIZE, secondary_options);
+
+    // Enough to push the first objects out of the primary
+    write(500, 2000);
+    std::string value;
+    bool caught_up = secondary->catchUp().ok() &&
+                     secondary->getStats().main_items == primary->getStats().main_items &&
+                     secondary->get("sec1999", &value).ok() &&
+                     !secondary->get("sec0", &value).ok() &&
+                     secondary->put("sec0", "value").IsNotSupported();
+    std::cout << "Secondary caught up with evictions and appends: "
+              << (caught_up ? "Yes" : "No") << "\n";
+
+    // Overwrites and promotions rewrite objects at new sequences in either
+    // tier; the next catch-up must index both copies' new locations
+    S3FIFOConfig config = primary->currentConfig();
+    config.promotion_probability = 1.0;
+    config.min_access_count = 1;
+    primary->setConfig(config);
+    primary->put("sec1990", std::string(1024, 'o'));
+    primary->get("sec1500", &value);
+    primary->get("sec1500", &value);
+    bool rewritten = secondary->catchUp().ok() &&
+                     secondary->getStats().small_items == primary->getStats().small_items &&
+                     secondary->getStats().main_items == primary->getStats().main_items &&
+                     secondary->get("sec1990", &value).ok() && value == std::string(1024, 'o') &&
+                     secondary->get("sec1500", &value).ok();
+    std::cout << "Secondary followed overwrites and promotions: "
+              << (rewritten ? "Yes" : "No") << "\n";
+
+    // The primary drains hints every 10ms; with the mirror, hits land in
+    // the shared frequencies instead and no hint is sent
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    bool hinted = shared_index_slots > 0
+        ? secondary->getStats().hints_forwarded == 0
+        : secondary->getStats().hints_forwarded > 0 && primary->getStats().hints_applied > 0;
+    std::cout << "Secondary hits reached the primary: " << (hinted ? "Yes" : "No") << "\n";
+
+    SharedIndex::remove(SharedIndex::nameFor(path));
+    return caught_up && rewritten && hinted;
+}
+
+// Hot-reloadable config: invalid values are refused, and a new promotion
+// policy applies to the next read
+bool runConfigTest() {
+    std::cout << "\n=== Running Config Reload Test ===\n";
+
+    S3FIFOOptions options;
+    options.config.promotion_probability = 0.0;
+    options.miss_sketch_width = 0;
+    auto cache = openFresh("/tmp/s3fifo_config_test", TEST_CACHE_SIZE, options);
+
+    std::string value;
+    cache->put("cfg", "value");
+    cache->get("cfg", &value);
+    cache->get("cfg", &value);
+    bool stayed = cache->getStats().small_items == 0;
+
+    S3FIFOConfig config = cache->currentConfig();
+    config.promotion_probability = 2.0;
+    bool refused = cache->setConfig(config).IsInvalidArgument() &&
+                   cache->currentConfig().promotion_probability == 0.0;
+
+    config.promotion_probability = 1.0;
+    config.min_access_count = 1;
+    bool applied = cache->setConfig(config).ok() &&
+                   cache->currentConfig().promotion_probability == 1.0 &&
+                   cache->get("cfg", &value).ok() && cache->getStats().small_items == 1;
+    std::cout << "Invalid config refused: " << (refused ? "Yes" : "No")
+              << ", new promotion policy applied: " << (stayed && applied ? "Yes" : "No") << "\n";
+
+    return refused && stayed && applied;
+}
+
+// Wall-clock aging: frequencies decay every decay_interval_ms, and a
+// small-queue object hit too rarely within demotion_age is demoted
+bool runAgingTest() {
+    std::cout << "\n=== Running Aging Test ===\n";
+
+    S3FIFOOptions options;
+    options.miss_sketch_width = 0;
+    options.config.promotion_probability = 1.0;
+    options.config.min_access_count = 3;
+    options.config.aging_clock = AgingClock::kWallClock;
+    options.config.demotion_age = 50;
+    options.config.decay_interval_ms = 50;
+    auto cache = openFresh("/tmp/s3fifo_aging_test", TEST_CACHE_SIZE, options);
+    auto pause = [] { std::this_thread::sleep_for(std::chrono::milliseconds(100)); };
+
+    // Two hits, then a decay (run by the next put) halves them: the third
+    // hit no longer reaches min_access_count
+    std::string value;
+    cache->put("decayed", "value");
+    cache->get("decayed", &value);
+    cache->get("decayed", &value);
+    pause();
+    cache->put("tick", "value");
+    cache->get("decayed", &value);
+    bool decayed = cache->getStats().small_items == 0;
+    std::cout << "Frequencies decayed: " << (decayed ? "Yes" : "No") << "\n";
+
+    // Promoted, hit once at once, then once more after demotion_age
+    cache->put("aged", "value");
+    for (int i = 0; i < 3; i++) {
+        cache->get("aged", &value);
+    }
+    bool promoted = cache->getStats().small_items == 1;
+    cache->get("aged", &value);
+    bool kept = cache->getStats().small_items == 1;
+    pause();
+    cache->get("aged", &value);
+    bool demoted = promoted && kept && cache->getStats().small_items == 0 &&
+                   cache->get("aged", &value).ok();
+    std::cout << "Promoted object demoted after demotion_age: " << (demoted ? "Yes" : "No") << "\n";
+
+    return decayed && demoted;
+}
+
+// Miss sketch: a key that kept missing starts with the frequency its
+// misses earned
+bool runMissSketchTest() {
+    std::cout << "\n=== Running Miss Sketch Test ===\n";
+
+    S3FIFOOptions options;
+    options.config.promotion_probability = 1.0;
+    options.config.min_access_count = 3;
+    auto cache = openFresh("/tmp/s3fifo_miss_sketch_test", TEST_CACHE_SIZE, options);
+
+    // One hit on a fresh key is not enough to promote it...
+    std::string value;
+    cache->put("fresh", "value");
+    cache->get("fresh", &value);
+    bool fresh_stayed = cache->getStats().small_items == 0;
+
+    // ...but a key that missed three times first is promoted on its first hit
+    for (int i = 0; i < 3; i++) {
+        cache->get("wanted", &value);
+    }
+    cache->put("wanted", "value");
+    cache->get("wanted", &value);
+    auto stats = cache->getStats();
+    bool seeded = fresh_stayed && stats.small_items == 1 && stats.miss_sketch_bytes > 0;
+    std::cout << "Missed key admitted with its miss frequency: " << (seeded ? "Yes" : "No")
+              << " (sketch " << stats.miss_sketch_bytes << " bytes)\n";
+
+    return seeded;
+}
+
+// Ghost filter: evicted keys are remembered in memory, and one that comes
+// back is promoted on its first hit
+bool runGhostFilterTest() {
+    std::cout << "\n=== Running Ghost Filter Test ===\n";
+
+    S3FIFOOptions options;
+    options.ghost_filter_entries = 10000;
+    options.config.promotion_probability = 0.0;   // Only ghost hits promote
+    auto cache = openFresh("/tmp/s3fifo_ghost_filter_test", 1024 * 1024, options);
+
+    for (int i = 0; i < 2000; i++) {
+        cache->put("ghost" + std::to_string(i), std::string(1024, 'g'));
+    }
+    auto stats = cache->getStats();
+    bool remembered = stats.ghost_items > 0 && stats.ghost_filter_bytes > 0;
+
+    // The oldest object was evicted; back in the cache, a hit promotes it
+    std::string value;
+    bool evicted = !cache->get("ghost0", &value).ok();
+    cache->put("ghost0", std::string(1024, 'g'));
+    cache->get("ghost0", &value);
+    bool promoted = evicted && cache->getStats().small_items == 1;
+    std::cout << "Ghost remembers " << stats.ghost_items << " evicted keys ("
+              << stats.ghost_filter_bytes << " bytes), returning key promoted: "
+              << (remembered && promoted ? "Yes" : "No") << "\n";
+
+    return remembered && promoted;
+}
+
+// Striped counters: diff() of two snapshots counts exactly the requests
+// made in between, from several threads
+bool runCountersTest() {
+    std::cout << "\n=== Running Counters Test ===\n";
+
+    const int THREADS = 4;
+    const int REQUESTS = 1000;   // Per thread, half hits and half misses
+    auto cache = openFresh("/tmp/s3fifo_counters_test", TEST_CACHE_SIZE);
+    cache->put("present", "value");
+
+    auto before = cache->snapshot();
+    std::vector<std::thread> readers;
+    for (int t = 0; t < THREADS; t++) {
+        readers.emplace_back([&] {
+            std::string value;
+            for (int i = 0; i < REQUESTS; i++) {
+                cache->get(i % 2 == 0 ? "present" : "absent", &value);
+            }
+        });
+    }
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    auto events = S3FIFORocksDB::diff(before, cache->snapshot());
+    const uint64_t expected = THREADS * REQUESTS / 2;
+    bool counted = events.hits == expected && events.misses == expected &&
+                   events.small_items + events.main_items == 1;
+    std::cout << "Counted " << events.hits << " hits and " << events.misses << " misses of "
+              << expected << " each: " << (counted ? "Yes" : "No") << "\n";
+
+    return counted;
+}
+
+// Throughput of one shared instance vs thread-per-core shards, for
+// 1, 2, 4, ... up to max_cores threads
+void runScalingBenchmark(size_t max_cores) {
+    std::cout << "\n=== Running Thread-per-core Scaling Benchmark ===\n";
+
+    const size_t CACHE_PER_CORE = 16 * 1024 * 1024;   // 16MB
+    const uint64_t KEY_SPACE = 100000;
+    const int OPS_PER_THREAD = 50000;
+
+    // Skewed read-mostly workload; a miss fetches and inserts the object
+    auto workload = [&](size_t thread_id, auto&& get, auto&& put) {
+        std::mt19937_64 rng(thread_id + 1);
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        std::string value;
+        for (int i = 0; i < OPS_PER_THREAD; i++) {
+            uint64_t id = static_cast<uint64_t>(KEY_SPACE * std::pow(uniform(rng), 3.0));
+            std::string key = "obj" + std::to_string(id);
+            if (!get(key, &value).ok()) {
+                put(key, std::string(512, 'a' + id % 26));
+            }
+        }
+    };
+
+    for (size_t cores = 1; cores <= max_cores; cores *= 2) {
+        double ops = static_cast<double>(cores) * OPS_PER_THREAD;
+
+        double shared_seconds;
+        {
+            auto cache = openFresh("/tmp/s3fifo_scaling_shared", CACHE_PER_CORE * cores);
+            auto start = std::chrono::steady_clock::now();
+            std::vector<std::thread> threads;
+            for (size_t t = 0; t < cores; t++) {
+                threads.emplace_back([&, t] {
+                    workload(t,
+                             [&](const std::string& k, std::string* v) { return cache->get(k, v); },
+                             [&](const std::string& k, const std::string& v) { return cache->put(k, v); });
+                });
+            }
+            for (auto& thread : threads) {
+                thread.join();
+            }
+            shared_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        std::string tpc_path = "/tmp/s3fifo_scaling_tpc";
+        std::filesystem::remove_all(tpc_path);
+        double tpc_seconds;
+        double forwarded;
+        {
+            S3FIFOOptions options;
+            options.num_shards = cores;
+            ThreadPerCoreS3FIFO cache(tpc_path, CACHE_PER_CORE * cores, 0.1, 0.1, options);
+            spdlog::get("s3fifo")->set_level(spdlog::level::warn);
+            auto start = std::chrono::steady_clock::now();
+            cache.run([&](ThreadPerCoreS3FIFO::Core& core) {
+                workload(core.id(),
+                         [&](const std::string& k, std::string* v) { return core.get(k, v); },
+                         [&](const std::string& k, const std::string& v) { return core.put(k, v); });
+            });
+            tpc_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            forwarded = cache.getStats().forwarded_ratio();
+        }
+
+        std::cout << cores << " cores: shared " << ops / shared_seconds / 1e6 << " Mops/s"
+                  << ", thread-per-core " << ops / tpc_seconds / 1e6 << " Mops/s"
+                  << " (" << forwarded * 100 << "% forwarded)\n";
+    }
+}
+
 int main() {
+    bool passed = true;
+
     // Run paper's example test
     runPaperExample();
 
     // Run scan resistance test
     runScanResistanceTest();
 
-    return 0;
+    // Compare compression policies
+    runCompressionBenchmark();
+
+    // Concurrent put throughput with group commit
+    runGroupCommitBenchmark();
+
+    // multiPut edge cases and byte budget under bulk loads
+    passed &= runMultiPutTest();
+
+    // Warm-up ingest stays within the main budget
+    passed &= runWarmupTest();
+
+    // Hot-set export/import round trip and damaged files
+    passed &= runHotSetTest();
+
+    // Shrinking fits both tiers into the new budgets
+    passed &= runResizeTest();
+
+    // Parallel recovery restores contents and accounting
+    passed &= runRecoveryTest();
+
+    // A checkpoint opens as a warm clone
+    passed &= runCheckpointTest();
+
+    // A secondary follows the primary's writes and evictions
+    passed &= runSecondaryTest(0);
+    passed &= runSecondaryTest(8192);
+
+    // Policy tunables swap while the cache serves
+    passed &= runConfigTest();
+
+    // Frequency decay and time-based quick demotion
+    passed &= runAgingTest();
+
+    // Missed keys are admitted with the frequency their misses earned
+    passed &= runMissSketchTest();
+
+    // In-memory ghost of evicted keys
+    passed &= runGhostFilterTest();
+
+    // Snapshot deltas of the striped counters
+    passed &= runCountersTest();
+
+    // Scale a shared instance vs thread-per-core shards up to the cores
+    // present; it takes minutes, so it only runs on request
+    if (std::getenv("S3FIFO_SCALING_BENCHMARK")) {
+        runScalingBenchmark(std::max<size_t>(1, std::thread::hardware_concurrency()));
+    }
+
+    return passed ? 0 : 1;
 } 
\ No newline at end of file